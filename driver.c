@@ -2,12 +2,46 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "linkedlist.c"
 #include "hilbert_r_tree.c"
+#include "hilbert_r_tree_sharded.c"
+
+void exportPoint(spatialData * sd, void * ctx){
+    fprintf((FILE *) ctx, "%.0f %.0f\n", sd->r.minDim[0], sd->r.minDim[1]);
+}
+
+typedef struct ingestTask{
+    shardedHRT * shrt;
+    spatialData ** datapoints;
+    int count;
+    int offset;
+    int stride;
+} ingestTask;
+
+void * ingestWorker(void * arg){
+    ingestTask * task = arg;
+    for(int i = task->offset; i < task->count; i += task->stride)
+        insertToShardedHRT(task->shrt, task->datapoints[i]);
+    return NULL;
+}
+
+int comparePointers(const void * a, const void * b){
+    uintptr_t x = (uintptr_t) *(void * const *) a, y = (uintptr_t) *(void * const *) b;
+    return (x > y) - (x < y);
+}
+
+void sortedResults(LinkedList * list, void ** out){
+    int i = 0;
+    for(LLNode * current = list->head; current != NULL; current = current->next)
+        out[i++] = current->data;
+    qsort(out, list->count, sizeof(void *), comparePointers);
+}
 
 int main(){
     FILE* fp = fopen("bigtest.txt", "r");
     hilbertRTree* hrt = createHilbertRTree();
+    LinkedList * datapoints = createLinkedList();
     char buffer[1024];
     while(fgets(buffer, BUFFERSIZE, fp)!=NULL){
         char* symRead = strtok(buffer, "\n");
@@ -33,6 +67,7 @@ int main(){
             sd->hilbertValue = calculateHilbertValue(sd->r);
 
             insertToHRT(hrt, sd);
+            llInsert(datapoints, sd);
             symRead = strtok(NULL, "\n");
         }
     }
@@ -43,6 +78,9 @@ int main(){
     while(choice!=0){
         printf("Choose from given options\n\n");
         printf("- To make a query, enter 1\n");
+        printf("- To export datapoints in hilbert order, enter 2\n");
+        printf("- To make a level-of-detail query, enter 3\n");
+        printf("- To ingest the datapoints into a sharded tree with several threads and compare a query, enter 4\n");
         printf("- To exit, enter 0\n\n");
         scanf("%d", &choice);
         printf("\n");
@@ -59,6 +97,88 @@ int main(){
                 printf("\n");
                 searchHRT(hrt, queryRect);
                 break;
+            case 2:
+                printf("Enter the output file name: ");
+                char fileName[BUFFERSIZE];
+                scanf("%1023s", fileName);
+                FILE* out = fopen(fileName, "w");
+                if(out==NULL){
+                    printf("Could not open %s\n\n", fileName);
+                    break;
+                }
+                exportHRT(hrt, exportPoint, out);
+                fclose(out);
+                printf("Exported to %s\n\n", fileName);
+                break;
+            case 3:
+                printf("Enter the query rectangle and the maximum number of clusters in the format: x1 y1 x2 y2 n: ");
+                int maxResults;
+                scanf("%lf %lf %lf %lf %d", &x1, &y1, &x2, &y2, &maxResults);
+                queryRect.maxDim[0] = max(x1, x2);
+                queryRect.maxDim[1] = max(y1, y2);
+                queryRect.minDim[0] = min(x1, x2);
+                queryRect.minDim[1] = min(y1, y2);
+                printf("\n");
+                LinkedList * clusters = searchLODHRT(hrt, queryRect, maxResults);
+                printf("Found %d clusters\n\n", clusters->count);
+                for(LLNode * current = clusters->head; current != NULL; current = current->next){
+                    lodCluster * c = current->data;
+                    printf("Cluster of %lld at (%f,%f), MBR [(%f,%f),(%f,%f)]\n", c->count, c->representative->r.minDim[0], c->representative->r.minDim[1], c->r.minDim[0], c->r.minDim[1], c->r.maxDim[0], c->r.maxDim[1]);
+                    free(c);
+                }
+                printf("\n");
+                freeLinkedList(clusters);
+                break;
+            case 4:
+                printf("Enter the number of threads and the query rectangle in the format: t x1 y1 x2 y2: ");
+                int threadCount;
+                scanf("%d %lf %lf %lf %lf", &threadCount, &x1, &y1, &x2, &y2);
+                threadCount = max(1, min(threadCount, MAXSHARDS));
+                queryRect.maxDim[0] = max(x1, x2);
+                queryRect.maxDim[1] = max(y1, y2);
+                queryRect.minDim[0] = min(x1, x2);
+                queryRect.minDim[1] = min(y1, y2);
+                printf("\n");
+
+                spatialData ** all = (spatialData **) malloc(sizeof(spatialData *) * max(1, datapoints->count));
+                int k = 0;
+                for(LLNode * current = datapoints->head; current != NULL; current = current->next)
+                    all[k++] = current->data;
+                shardedHRT * shrt = createShardedHRT(threadCount);
+                ingestTask tasks[MAXSHARDS];
+                pthread_t threads[MAXSHARDS];
+                struct timespec start, end;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                for(int t = 0; t < threadCount; t++){
+                    tasks[t] = (ingestTask){shrt, all, datapoints->count, t, threadCount};
+                    pthread_create(&threads[t], NULL, ingestWorker, &tasks[t]);
+                }
+                for(int t = 0; t < threadCount; t++)
+                    pthread_join(threads[t], NULL);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+                printf("Inserted %d datapoints with %d threads in %.1f ms, %d shards\n", datapoints->count, threadCount, ms, atomic_load(&shrt->map)->shardCount);
+
+                LinkedList * shardedResult = searchShardedHRT(shrt, queryRect);
+                LinkedList * treeResult = createLinkedList();
+                if(rectangleIntersects(hrt->root->maxBoundingRect, queryRect))
+                    recursiveHRTSearch(hrt->root, queryRect, treeResult);
+                bool same = shardedResult->count == treeResult->count;
+                if(same){
+                    void ** a = (void **) malloc(sizeof(void *) * max(1, treeResult->count));
+                    void ** b = (void **) malloc(sizeof(void *) * max(1, treeResult->count));
+                    sortedResults(shardedResult, a);
+                    sortedResults(treeResult, b);
+                    same = memcmp(a, b, sizeof(void *) * treeResult->count) == 0;
+                    free(a);
+                    free(b);
+                }
+                printf("Sharded tree found %d, tree found %d: %s\n\n", shardedResult->count, treeResult->count, same ? "results match" : "results differ");
+                freeLinkedList(shardedResult);
+                freeLinkedList(treeResult);
+                freeShardedHRT(shrt);
+                free(all);
+                break;
             case 0:
                 break;
         }
@@ -45,7 +45,10 @@ HRTNode * createNewNode(int type){
     n->type = type;
     n->count = 0;
     n->parent = NULL;
+    n->prev = NULL;
+    n->next = NULL;
     n->maxHilbertValue = 0;
+    n->subtreeCount = 0;
     for (int i = 0; i < DIMENSIONS; i++)
     {
         (n->maxBoundingRect).maxDim[i] = INT_MIN;
@@ -66,6 +69,36 @@ hilbertRTree *createHilbertRTree(){
     return hrt;
 }
 
+/*
+    * Function: freeHRTNode
+    * -------------------------------
+    *  Frees a node and all nodes below it
+    *  Datapoints are owned by the caller and are not freed
+    *  n: root of the subtree to be freed
+    *  Time complexity: O(n)
+    *  n is number of nodes in the subtree
+*/
+void freeHRTNode(HRTNode * n){
+    if(n->type==NONLEAFNODE)
+        for(int i = 0; i < n->count; i++)
+            freeHRTNode(n->children[i]);
+    free(n);
+}
+
+/*
+    * Function: freeHilbertRTree
+    * -------------------------------
+    *  Frees a hilbert r tree and all its nodes
+    *  Datapoints are owned by the caller and are not freed
+    *  hrt: hilbert r tree to be freed
+    *  Time complexity: O(n)
+    *  n is number of nodes in the tree
+*/
+void freeHilbertRTree(hilbertRTree * hrt){
+    freeHRTNode(hrt->root);
+    free(hrt);
+}
+
 /*
     * Function: rectangleIntersects
     * -------------------------------
@@ -85,6 +118,25 @@ bool rectangleIntersects(rect target, rect r){
     return true;
 }
 
+/*
+    * Function: rectangleContains
+    * -------------------------------
+    * Checks if a rectangle lies completely inside another
+    * outer: enclosing rectangle
+    * r: rectangle to be checked
+    * Time complexity: O(1)
+*/
+bool rectangleContains(rect outer, rect r){
+    for (int i = 0; i < DIMENSIONS; i++)
+    {
+        if (r.minDim[i] < outer.minDim[i] || r.maxDim[i] > outer.maxDim[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 /*
     * Function: recursiveHRTSearch
     * -------------------------------
@@ -131,6 +183,284 @@ LinkedList * searchHRT(hilbertRTree *hrt, rect queryRect){
     return result;
 }
 
+/*
+    * Function: createSearchOptions
+    * -------------------------------
+    * Creates search options with no limit, budget, deadline or cancel flag
+    * Time complexity: O(1)
+*/
+searchOptions createSearchOptions(){
+    searchOptions options;
+    options.limit = 0;
+    options.visitBudget = 0;
+    options.timeLimitMs = 0;
+    options.cancel = NULL;
+    return options;
+}
+
+/*
+    * Function: createSearchContinuation
+    * -------------------------------
+    * Creates a continuation positioned at the start of a search
+    * Time complexity: O(1)
+*/
+searchContinuation createSearchContinuation(){
+    searchContinuation cont;
+    cont.hilbertValue = 0;
+    cont.skip = 0;
+    cont.done = false;
+    return cont;
+}
+
+/*
+    * Function: elapsedMs
+    * -------------------------------
+    * Returns milliseconds elapsed since start
+    * Time complexity: O(1)
+*/
+double elapsedMs(struct timespec start){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec)*1e3 + (now.tv_nsec - start.tv_nsec)/1e6;
+}
+
+/*
+    * Function: recursiveBoundedSearch
+    * -------------------------------
+    * Searches a node in hilbert order, skipping everything before the
+    * continuation and moving it past every datapoint examined
+    * Datapoints sharing the continuation's hilbert value are told apart by
+    * how many of them were already examined, so the walk must meet them in
+    * the same order on every call
+    * node: root of HRT which is to be searched
+    * s: state of the search
+    * Returns true if the search has to stop early
+*/
+bool recursiveBoundedSearch(HRTNode * node, boundedSearch * s){
+    if(!rectangleIntersects(node->maxBoundingRect, s->queryRect) || node->maxHilbertValue < s->cont->hilbertValue)
+        return false;
+
+    s->visits++;
+    if(s->options.cancel != NULL && atomic_load(s->options.cancel)){
+        s->status = SEARCHCANCELLED;
+        return true;
+    }
+    if(s->examined > 0 && ((s->options.visitBudget > 0 && s->visits > s->options.visitBudget)
+        || (s->options.timeLimitMs > 0 && s->visits % DEADLINECHECK == 0 && elapsedMs(s->start) > s->options.timeLimitMs))){
+        s->status = SEARCHTIMEDOUT;
+        return true;
+    }
+
+    if(node->type == LEAFNODE){
+        for(int i = 0; i < node->count; i++){
+            spatialData * sd = node->datapoints[i];
+            if(sd->hilbertValue < s->cont->hilbertValue)
+                continue;
+            if(sd->hilbertValue == s->startHilbertValue && s->skipped < s->startSkip){
+                s->skipped++;
+                continue;
+            }
+            if(rectangleIntersects(sd->r, s->queryRect)){
+                if(s->options.limit > 0 && s->found == s->options.limit){
+                    s->status = SEARCHTRUNCATED;
+                    return true;
+                }
+                llInsert(s->result, sd);
+                s->found++;
+            }
+            s->examined++;
+            if(sd->hilbertValue == s->cont->hilbertValue)
+                s->cont->skip++;
+            else{
+                s->cont->hilbertValue = sd->hilbertValue;
+                s->cont->skip = 1;
+            }
+        }
+    }
+    else{
+        for(int i = 0; i < node->count; i++)
+            if(recursiveBoundedSearch(node->children[i], s))
+                return true;
+    }
+    return false;
+}
+
+/*
+    * Function: searchBoundedHRT
+    * -------------------------------
+    * Searches for datapoints in a rectangle, stopping early once options.limit
+    * datapoints are found, options.visitBudget nodes are visited,
+    * options.timeLimitMs milliseconds pass or *options.cancel is set
+    * Datapoints are found in hilbert order and appended to result; calling
+    * again with the same continuation returns the ones not yet found
+    * The budget and deadline are only enforced once at least one datapoint
+    * has been examined, so repeated calls always make progress
+    * The continuation relies on a depth-first walk meeting datapoints in
+    * non-decreasing hilbert order, which insertion keeps even for repeated keys
+    * hrt: hilbert r tree which is to be searched
+    * queryRect: rectangle in which datapoints are to be searched
+    * options: limits of the search, zero or NULL fields are unbounded
+    * cont: continuation created by createSearchContinuation
+    * result: linked list in which results are to be stored
+    * Returns SEARCHCOMPLETE, SEARCHTRUNCATED, SEARCHTIMEDOUT or SEARCHCANCELLED
+    * Time complexity: O(n*M)
+    * n is number of nodes visited
+*/
+int searchBoundedHRT(hilbertRTree * hrt, rect queryRect, searchOptions options, searchContinuation * cont, LinkedList * result){
+    if(cont->done)
+        return SEARCHCOMPLETE;
+    boundedSearch s;
+    s.queryRect = queryRect;
+    s.options = options;
+    s.cont = cont;
+    s.startHilbertValue = cont->hilbertValue;
+    s.startSkip = cont->skip;
+    s.skipped = 0;
+    s.found = 0;
+    s.examined = 0;
+    s.visits = 0;
+    clock_gettime(CLOCK_MONOTONIC, &s.start);
+    s.status = SEARCHCOMPLETE;
+    s.result = result;
+    if(!recursiveBoundedSearch(hrt->root, &s))
+        cont->done = true;
+    return s.status;
+}
+
+/*
+    * Function: findRepresentative
+    * -------------------------------
+    * Finds a datapoint of a subtree that intersects the query rectangle,
+    * trying entries from the middle of each node outwards
+    * A subtree lying inside the query is descended along its middle entries
+    * without further checks
+    * node: root of the subtree
+    * queryRect: rectangle the datapoint has to intersect
+    * Returns NULL if no datapoint of the subtree intersects queryRect
+    * Time complexity: O(M*h) unless intersecting subtrees hold no match
+    * M is maximum number of entries in a node
+    * h is height of the node
+*/
+spatialData * findRepresentative(HRTNode * node, rect queryRect){
+    if(rectangleContains(queryRect, node->maxBoundingRect)){
+        while(node->type != LEAFNODE)
+            node = node->children[node->count/2];
+        return node->datapoints[node->count/2];
+    }
+    for(int k = 0; k < node->count; k++){
+        int i = (node->count/2 + k) % node->count;
+        if(node->type == LEAFNODE){
+            if(rectangleIntersects(node->datapoints[i]->r, queryRect))
+                return node->datapoints[i];
+        }
+        else if(rectangleIntersects(node->children[i]->maxBoundingRect, queryRect)){
+            spatialData * sd = findRepresentative(node->children[i], queryRect);
+            if(sd != NULL)
+                return sd;
+        }
+    }
+    return NULL;
+}
+
+/*
+    * Function: createLODCluster
+    * -------------------------------
+    * Creates a cluster summarizing a node, or a single datapoint when node is NULL
+    * The representative of a node is one of its datapoints intersecting the
+    * query rectangle, found by findRepresentative
+    * Returns NULL if no datapoint of the node intersects queryRect
+    * Time complexity: O(M*h)
+    * M is maximum number of entries in a node
+    * h is height of the node
+*/
+lodCluster * createLODCluster(HRTNode * node, spatialData * sd, rect queryRect){
+    if(node != NULL){
+        sd = findRepresentative(node, queryRect);
+        if(sd == NULL)
+            return NULL;
+    }
+    lodCluster * c = (lodCluster *) malloc(sizeof(lodCluster));
+    c->node = node;
+    c->representative = sd;
+    if(node == NULL){
+        c->r = sd->r;
+        c->count = 1;
+        return c;
+    }
+    c->r = node->maxBoundingRect;
+    c->count = node->subtreeCount;
+    return c;
+}
+
+/*
+    * Function: searchLODHRT
+    * -------------------------------
+    * Searches a rectangle at a level of detail bounded by maxResults
+    * Descends level by level, expanding a node into its intersecting entries
+    * only while the result would stay within maxResults, and returns the
+    * remaining nodes as clusters with their bounding rectangle, datapoint
+    * count and a representative datapoint intersecting the query rectangle
+    * Nodes holding no datapoint in the query rectangle are dropped
+    * The count of a cluster covers its whole subtree, including datapoints
+    * just outside the query rectangle
+    * hrt: hilbert r tree which is to be searched
+    * queryRect: rectangle in which datapoints are to be searched
+    * maxResults: maximum number of clusters to be returned
+    * Time complexity: O(maxResults*M*h)
+    * M is maximum number of entries in a node
+    * h is height of the tree
+*/
+LinkedList * searchLODHRT(hilbertRTree * hrt, rect queryRect, int maxResults){
+    LinkedList * frontier = createLinkedList();
+    if(maxResults > 0 && hrt->root->count > 0 && rectangleIntersects(hrt->root->maxBoundingRect, queryRect)){
+        lodCluster * c = createLODCluster(hrt->root, NULL, queryRect);
+        if(c != NULL)
+            llInsert(frontier, c);
+    }
+
+    bool expanded = true;
+    while(expanded){
+        expanded = false;
+        LinkedList * next = createLinkedList();
+        int size = frontier->count;
+        for(LLNode * curr = frontier->head; curr != NULL; curr = curr->next){
+            lodCluster * c = curr->data;
+            HRTNode * node = c->node;
+            if(node != NULL){
+                int k = 0;
+                for(int i = 0; i < node->count; i++){
+                    rect r = node->type==LEAFNODE ? node->datapoints[i]->r : node->children[i]->maxBoundingRect;
+                    if(rectangleIntersects(r, queryRect))
+                        k++;
+                }
+                if(size - 1 + k <= maxResults){
+                    for(int i = 0; i < node->count; i++){
+                        if(node->type==LEAFNODE){
+                            if(rectangleIntersects(node->datapoints[i]->r, queryRect))
+                                llInsert(next, createLODCluster(NULL, node->datapoints[i], queryRect));
+                        }
+                        else if(rectangleIntersects(node->children[i]->maxBoundingRect, queryRect)){
+                            lodCluster * child = createLODCluster(node->children[i], NULL, queryRect);
+                            if(child != NULL)
+                                llInsert(next, child);
+                            else
+                                k--;
+                        }
+                    }
+                    size += k - 1;
+                    free(c);
+                    expanded = true;
+                    continue;
+                }
+            }
+            llInsert(next, c);
+        }
+        freeLinkedList(frontier);
+        frontier = next;
+    }
+    return frontier;
+}
+
 /*
     * Function: chooseLeaf
     * -------------------------------
@@ -139,7 +469,7 @@ LinkedList * searchHRT(hilbertRTree *hrt, rect queryRect){
     * h: hilbert value of the datapoint
     * Time complexity: O(height of tree)
 */
-HRTNode *chooseLeaf(hilbertRTree *hrt, int h){
+HRTNode *chooseLeaf(hilbertRTree *hrt, long long int h){
     HRTNode * N = hrt->root;
     while (N->type != LEAFNODE)
     {
@@ -184,6 +514,8 @@ void insertToHRTnode(HRTNode* n, void * new){
         }
         n->datapoints[n->count] = newSD;
         n->count++;
+        n->subtreeCount++;
+        newSD = new;
         for(int i = 0; i < DIMENSIONS; i++){
             if(newSD->r.minDim[i]<n->maxBoundingRect.minDim[i])
                 n->maxBoundingRect.minDim[i] = newSD->r.minDim[i];
@@ -213,6 +545,8 @@ void insertToHRTnode(HRTNode* n, void * new){
         }
         n->children[n->count] = newNode;
         n->count++;
+        newNode = new;
+        n->subtreeCount += newNode->subtreeCount;
         for(int i = 0; i < DIMENSIONS; i++){
             if(newNode->maxBoundingRect.minDim[i]<n->maxBoundingRect.minDim[i])
                 n->maxBoundingRect.minDim[i] = newNode->maxBoundingRect.minDim[i];
@@ -224,25 +558,96 @@ void insertToHRTnode(HRTNode* n, void * new){
     }
 }
 
+/*
+    * Function: insertChildAfterHRTnode
+    * -------------------------------
+    * Inserts a child into a nonleaf node right after one of its children
+    * p: nonleaf node with room for another child
+    * after: child of p that the new child is to follow
+    * child: node to be inserted
+    * Time complexity: O(M)
+    * M is maximum number of entries in a node
+*/
+void insertChildAfterHRTnode(HRTNode * p, HRTNode * after, HRTNode * child){
+    int i = p->count;
+    while(i > 0 && p->children[i-1] != after){
+        p->children[i] = p->children[i-1];
+        i--;
+    }
+    p->children[i] = child;
+    p->count++;
+    child->parent = p;
+}
+
+/*
+    * Function: updateMBRandHV
+    * -------------------------------
+    * Recalculates and updates the max bounding rectangle, max hilbert value
+    * and subtree datapoint count of a node
+    * p: node whose max bounding rectangle and max hilbert value is to be updated
+    * Time complexity: O(n)
+    * n is number of entries in the node
+*/
+void updateMBRandHV(HRTNode * p){
+    p->maxHilbertValue = 0;
+    p->subtreeCount = p->type==LEAFNODE ? p->count : 0;
+    for(int i = 0; i < DIMENSIONS; i++){
+        p->maxBoundingRect.minDim[i] = INT_MAX;
+        p->maxBoundingRect.maxDim[i] = INT_MIN;
+    }
+    for(int i = 0; i < p->count; i++){
+        if(p->type==LEAFNODE){
+            spatialData * temp = p->datapoints[i];
+            for(int j = 0; j < DIMENSIONS; j++){
+                if(temp->r.minDim[j]<p->maxBoundingRect.minDim[j])
+                    p->maxBoundingRect.minDim[j] = temp->r.minDim[j];
+                if(temp->r.maxDim[j]>p->maxBoundingRect.maxDim[j])
+                    p->maxBoundingRect.maxDim[j] = temp->r.maxDim[j];
+            }
+            if(temp->hilbertValue>p->maxHilbertValue)
+                p->maxHilbertValue = temp->hilbertValue;
+        }
+        else{
+            HRTNode * temp = p->children[i];
+            for(int j = 0; j < DIMENSIONS; j++){
+                if(temp->maxBoundingRect.minDim[j]<p->maxBoundingRect.minDim[j])
+                    p->maxBoundingRect.minDim[j] = temp->maxBoundingRect.minDim[j];
+                if(temp->maxBoundingRect.maxDim[j]>p->maxBoundingRect.maxDim[j])
+                    p->maxBoundingRect.maxDim[j] = temp->maxBoundingRect.maxDim[j];
+            }
+            if(temp->maxHilbertValue>p->maxHilbertValue)
+                p->maxHilbertValue = temp->maxHilbertValue;
+            p->subtreeCount += temp->subtreeCount;
+        }
+    }
+}
+
 /*
     * Function: handleOverflow
     * -------------------------------
-    * Handles overflow in a node
+    * Handles overflow in a node by sharing its entries with its cooperating
+    * siblings, splitting off a new node only if all of them are full
     * n: node in which overflow is to be handled
-    * new: datapoint to be inserted
-    * Time complexity: O(n)
-    * n is number of entries in the node and its cooperating siblings
+    * new: datapoint or node to be inserted
+    * after: for a nonleaf node, the child that new is to be placed right after;
+    *        datapoints are placed by hilbert value and pass NULL
+    * result: filled with the sharing window and the split node, if any;
+    *         the split node is not yet inserted into the parent
+    * Time complexity: O(s*M)
+    * M is maximum number of entries in a node
+    * s is number of cooperating siblings allowed
 */
-LinkedList * handleOverflow(HRTNode* n, void * new){
-    bool allFull = true, split=false;
-    LinkedList * Nodell = createLinkedList();
+void handleOverflow(HRTNode* n, void * new, HRTNode * after, overflowResult * result){
+    bool allFull = true;
+    result->count = 0;
+    result->splitNode = NULL;
     if(n->parent==NULL){
         HRTNode* newNode = createNewNode(NONLEAFNODE);
         insertToHRTnode(newNode,n);
-        llInsert(Nodell,n);
+        result->nodes[result->count++] = n;
     }
     else{
-        int pos;
+        int pos = 0;
         for(int i = 0; i < n->parent->count; i++)
             if(n->parent->children[i]==n){
                 pos = i;
@@ -261,173 +666,117 @@ LinkedList * handleOverflow(HRTNode* n, void * new){
            }
         }
         for(int i = optimalWindow; i < min(optimalWindow+SPLITTING,n->parent->count); i++)
-            llInsert(Nodell,n->parent->children[i]);
+            result->nodes[result->count++] = n->parent->children[i];
         if(MaxEmpty > 0) allFull = false;
     }
     if(allFull){
         HRTNode* newNode = createNewNode(n->type);
-        llInsert(Nodell,newNode);
-        split = true;
+        if(n->type==LEAFNODE){
+            HRTNode * last = result->nodes[result->count-1];
+            newNode->prev = last;
+            newNode->next = last->next;
+            if(last->next!=NULL)
+                last->next->prev = newNode;
+            last->next = newNode;
+        }
+        result->nodes[result->count++] = newNode;
+        result->splitNode = newNode;
     }
 
-    LinkedList * Childrenll = createLinkedList();
-    LLNode * curr = Nodell->head;
-    if(n->type==LEAFNODE){
-        spatialData * newSD = new;
-        bool inserted = false;
-        while(curr!=NULL){
-            HRTNode * temp = curr->data;
-            int ct = temp->count;
-            for(int i = 0; i < ct; i++){
-                if(!inserted && temp->datapoints[i]->hilbertValue > newSD->hilbertValue){
-                    llInsert(Childrenll, newSD);
+    void * entries[ORDER*SPLITTING + 1];
+    int entryCount = 0;
+    bool inserted = false;
+    for(int j = 0; j < result->count; j++){
+        HRTNode * temp = result->nodes[j];
+        for(int i = 0; i < temp->count; i++){
+            if(n->type==LEAFNODE){
+                if(!inserted && temp->datapoints[i]->hilbertValue > ((spatialData *) new)->hilbertValue){
+                    entries[entryCount++] = new;
                     inserted = true;
                 }
-                llInsert(Childrenll, temp->datapoints[i]);
-                temp->datapoints[i] = NULL;
-                temp->count--;
+                entries[entryCount++] = temp->datapoints[i];
             }
-            curr = curr->next;
-        }
-        if(!inserted)
-            llInsert(Childrenll, newSD);
-    }
-    else{
-        HRTNode * newNode = new;
-        bool inserted = false;
-        while(curr!=NULL){
-            HRTNode * temp = curr->data;
-            int ct = temp->count;
-            for(int i = 0; i < ct; i++){
-                if(!inserted && temp->children[i]->maxHilbertValue > newNode->maxHilbertValue){
-                    llInsert(Childrenll, newNode);
+            else{
+                entries[entryCount++] = temp->children[i];
+                if(temp->children[i] == after){
+                    entries[entryCount++] = new;
                     inserted = true;
                 }
-                llInsert(Childrenll, temp->children[i]);
-                temp->children[i] = NULL;
-                temp->count--;
             }
-            curr = curr->next;
         }
-        if(!inserted)
-            llInsert(Childrenll, newNode);
     }
+    if(!inserted)
+        entries[entryCount++] = new;
 
-    int childrenPerNode = Childrenll->count/Nodell->count;
-    int extraChildren = Childrenll->count%Nodell->count;
-
-    LLNode * currNode = Nodell->head;
-    LLNode * currChild = Childrenll->head;
-
-    while(currNode!=NULL){
-        HRTNode * temp = currNode->data;
-        for(int i = 0; i < childrenPerNode; i++){
-            insertToHRTnode(temp, currChild->data);
-            currChild = currChild->next;
-        }
-        if(extraChildren){
-            insertToHRTnode(temp, currChild->data);
-            currChild = currChild->next;
-            extraChildren--;
-        }
-        currNode = currNode->next;
-    }
-    if(split)
-        ((HRTNode *) Nodell->tail->data)->type = 10 + ((HRTNode *) Nodell->tail->data)->type;
-    freeLinkedList(Childrenll);
-    return Nodell;
-}
-
-/*
-    * Function: updateMBRandHV
-    * -------------------------------
-    * Recalculates and updates the max bounding rectangle and max hilbert value of a node
-    * p: node whose max bounding rectangle and max hilbert value is to be updated
-    * Time complexity: O(n)
-    * n is number of entries in the node
-*/
-void updateMBRandHV(HRTNode * p){
-    for(int i = 0; i < DIMENSIONS; i++){
-        p->maxBoundingRect.minDim[i] = INT_MAX;
-        p->maxBoundingRect.maxDim[i] = INT_MIN;
-    }
-    for(int i = 0; i < p->count; i++){
-        if(p->type==LEAFNODE){
-            spatialData * temp = p->datapoints[i];
-            for(int j = 0; j < DIMENSIONS; j++){
-                if(temp->r.minDim[j]<p->maxBoundingRect.minDim[j])
-                    p->maxBoundingRect.minDim[j] = temp->r.minDim[j];
-                if(temp->r.maxDim[j]>p->maxBoundingRect.maxDim[j])
-                    p->maxBoundingRect.maxDim[j] = temp->r.maxDim[j];
+    int childrenPerNode = entryCount/result->count;
+    int extraChildren = entryCount%result->count;
+    int next = 0;
+    for(int j = 0; j < result->count; j++){
+        HRTNode * temp = result->nodes[j];
+        temp->count = childrenPerNode + (j < extraChildren);
+        for(int i = 0; i < temp->count; i++){
+            if(n->type==LEAFNODE)
+                temp->datapoints[i] = entries[next++];
+            else{
+                temp->children[i] = entries[next++];
+                temp->children[i]->parent = temp;
             }
-            if(temp->hilbertValue>p->maxHilbertValue)
-                p->maxHilbertValue = temp->hilbertValue;
-        }
-        else{
-            HRTNode * temp = p->children[i];
-            for(int j = 0; j < DIMENSIONS; j++){
-                if(temp->maxBoundingRect.minDim[j]<p->maxBoundingRect.minDim[j])
-                    p->maxBoundingRect.minDim[j] = temp->maxBoundingRect.minDim[j];
-                if(temp->maxBoundingRect.maxDim[j]>p->maxBoundingRect.maxDim[j])
-                    p->maxBoundingRect.maxDim[j] = temp->maxBoundingRect.maxDim[j];
-            }
-            if(temp->maxHilbertValue>p->maxHilbertValue)
-                p->maxHilbertValue = temp->maxHilbertValue;
         }
+        updateMBRandHV(temp);
     }
 }
 
 /*
     * Function: adjustTree
     * -------------------------------
-    * Adjusts the tree after an insertion or deletion
+    * Adjusts the tree after an insertion, walking up one level at a time
     * hrt: hilbertRTree to be adjusted
-    * affectedNodes: list of nodes affected by the insertion or deletion
-    * Time complexity: O(n + h)
-    * n is number of nodes affected by the insertion or deletion
+    * affected: sibling nodes changed by the insertion and the split node
+    *           still to be inserted into their parent, if any
+    * A split node is placed right after the sibling it was split from rather
+    * than by max hilbert value, so leaves sharing a hilbert value keep the
+    * order of the leaf chain
+    * Time complexity: O(s*M*h)
+    * M is maximum number of entries in a node
+    * s is number of cooperating siblings allowed
     * h is height of the tree
 */
-void adjustTree(hilbertRTree * hrt, LinkedList * affectedNodes)
+void adjustTree(hilbertRTree * hrt, overflowResult * affected)
 {
-    if(affectedNodes->count==0)
-        return;
-    HRTNode * parentLastNode = NULL;
-    HRTNode * firstNode = affectedNodes->head->data;
-    HRTNode * lastNode = affectedNodes->tail->data;
-    if(lastNode->type>=10){
-        lastNode->type = lastNode->type - 10;
-        if(firstNode->parent->count==ORDER){
-            LinkedList * temp = handleOverflow(firstNode->parent, lastNode);
-            parentLastNode = temp->tail->data;
-            freeLinkedList(temp);
+    while(true){
+        HRTNode * parent = affected->nodes[0]->parent;
+        if(parent==NULL){
+            hrt->root = affected->nodes[0];
+            return;
         }
-        else{
-            insertToHRTnode(firstNode->parent, lastNode);
-        }
-    }
-    LinkedList * affectedParents = createLinkedList();
-    LLNode * curr = affectedNodes->head;
-    while(curr!=NULL){
-        HRTNode * temp = curr->data;
-        if(temp->parent!=NULL){
-            updateMBRandHV(temp->parent);
-            llInsert(affectedParents, temp->parent);
+        if(affected->splitNode!=NULL){
+            HRTNode * after = affected->nodes[affected->count-2];
+            if(parent->count==ORDER){
+                handleOverflow(parent, affected->splitNode, after, affected);
+                continue;
+            }
+            insertChildAfterHRTnode(parent, after, affected->splitNode);
         }
-        else{
-            hrt->root = temp;
+        rect oldMBR = parent->maxBoundingRect;
+        long long int oldHV = parent->maxHilbertValue, oldCount = parent->subtreeCount;
+        updateMBRandHV(parent);
+        if(affected->splitNode==NULL && oldHV==parent->maxHilbertValue
+            && memcmp(&oldMBR, &parent->maxBoundingRect, sizeof(rect))==0){
+            for(HRTNode * p = parent->parent; p != NULL; p = p->parent)
+                p->subtreeCount += parent->subtreeCount - oldCount;
+            return;
         }
-        curr = curr->next;
+        affected->nodes[0] = parent;
+        affected->count = 1;
+        affected->splitNode = NULL;
     }
-    if(parentLastNode && parentLastNode->type>=10)
-        llInsert(affectedParents, parentLastNode);
-    adjustTree(hrt, affectedParents);
-    freeLinkedList(affectedParents);
 }
 
 /*
     * Function: insertToHRT
     * -------------------------------
     * Inserts a datapoint into the hilbertRTree
+    * Allocates memory only when a node has to be split
     * hrt: hilbertRTree to be inserted into
     * sd: spatial data point to be inserted
     * Time complexity: O(s*M + h)
@@ -437,17 +786,320 @@ void adjustTree(hilbertRTree * hrt, LinkedList * affectedNodes)
 */
 void insertToHRT(hilbertRTree * hrt, spatialData *sd){
     HRTNode * l = chooseLeaf(hrt, sd->hilbertValue);
-    LinkedList * affectedNodes;
+    overflowResult affected;
     if (l->count == ORDER){
-        affectedNodes = handleOverflow(l, sd);
+        handleOverflow(l, sd, NULL, &affected);
     }
     else{
         insertToHRTnode(l, sd);
-        affectedNodes = createLinkedList();
-        llInsert(affectedNodes, l);
+        affected.nodes[0] = l;
+        affected.count = 1;
+        affected.splitNode = NULL;
+    }
+    adjustTree(hrt, &affected);
+}
+
+/*
+    * Function: findLeafHRT
+    * -------------------------------
+    * Finds the first leaf that can hold datapoints with hilbert value h or greater
+    * hrt: hilbert r tree which is to be searched
+    * h: hilbert value to be located
+    * Time complexity: O(M*h)
+    * M is maximum number of entries in a node
+    * h is height of the tree
+*/
+HRTNode * findLeafHRT(hilbertRTree * hrt, long long int h){
+    HRTNode * N = hrt->root;
+    while(N->type != LEAFNODE){
+        int i = 0;
+        while(i < N->count - 1 && N->children[i]->maxHilbertValue < h)
+            i++;
+        N = N->children[i];
+    }
+    return N;
+}
+
+/*
+    * Function: scanHilbertRangeHRT
+    * -------------------------------
+    * Creates a cursor over all datapoints with hilbert value in [hlo, hhi]
+    * The cursor walks the leaf chain and is invalidated by any insertion or
+    * reorganizeHRTStep, which may free the leaf it points at; re-seek with
+    * scanHilbertRangeHRT from the last hilbert value returned to resume
+    * hrt: hilbert r tree which is to be scanned
+    * hlo: lowest hilbert value to be returned
+    * hhi: highest hilbert value to be returned
+    * Time complexity: O(M*h)
+*/
+hrtCursor scanHilbertRangeHRT(hilbertRTree * hrt, long long int hlo, long long int hhi){
+    hrtCursor cursor;
+    cursor.leaf = findLeafHRT(hrt, hlo);
+    cursor.index = 0;
+    cursor.highHilbertValue = hhi;
+    while(cursor.leaf != NULL){
+        while(cursor.index < cursor.leaf->count && cursor.leaf->datapoints[cursor.index]->hilbertValue < hlo)
+            cursor.index++;
+        if(cursor.index < cursor.leaf->count)
+            break;
+        cursor.leaf = cursor.leaf->next;
+        cursor.index = 0;
+    }
+    return cursor;
+}
+
+/*
+    * Function: nextHRTCursor
+    * -------------------------------
+    * Returns the next datapoint of a cursor in hilbert order, or NULL once
+    * the range is exhausted
+    * cursor: cursor created by scanHilbertRangeHRT
+    * Time complexity: O(1) amortized
+*/
+spatialData * nextHRTCursor(hrtCursor * cursor){
+    while(cursor->leaf != NULL && cursor->index >= cursor->leaf->count){
+        cursor->leaf = cursor->leaf->next;
+        cursor->index = 0;
+    }
+    if(cursor->leaf == NULL)
+        return NULL;
+    spatialData * sd = cursor->leaf->datapoints[cursor->index];
+    if(sd->hilbertValue > cursor->highHilbertValue){
+        cursor->leaf = NULL;
+        return NULL;
+    }
+    cursor->index++;
+    return sd;
+}
+
+/*
+    * Function: exportHRT
+    * -------------------------------
+    * Streams every datapoint of the tree to a callback in hilbert order
+    * hrt: hilbert r tree to be exported
+    * emit: callback invoked once per datapoint
+    * ctx: passed through to emit unchanged
+    * Time complexity: O(n + M*h)
+    * n is number of datapoints in the tree
+*/
+void exportHRT(hilbertRTree * hrt, void (*emit)(spatialData *, void *), void * ctx){
+    hrtCursor cursor = scanHilbertRangeHRT(hrt, 0, MAXHILBERTVALUE);
+    spatialData * sd;
+    while((sd = nextHRTCursor(&cursor)) != NULL)
+        emit(sd, ctx);
+}
+
+/*
+    * Function: buildHilbertRTree
+    * -------------------------------
+    * Builds a packed hilbert r tree from datapoints sorted by hilbert value
+    * in one pass, filling each level with as few nodes as can hold it
+    * entries: datapoints in non-decreasing hilbert order
+    * count: number of datapoints
+    * Time complexity: O(n)
+    * n is number of datapoints
+*/
+hilbertRTree * buildHilbertRTree(spatialData ** entries, long long int count){
+    hilbertRTree * hrt = createHilbertRTree();
+    if(count == 0)
+        return hrt;
+    long long int nodeCount = (count + ORDER - 1)/ORDER;
+    HRTNode ** level = (HRTNode **) malloc(sizeof(HRTNode *) * nodeCount);
+    long long int next = 0;
+    for(long long int j = 0; j < nodeCount; j++){
+        HRTNode * leaf = j == 0 ? hrt->root : createNewNode(LEAFNODE);
+        leaf->count = count/nodeCount + (j < count%nodeCount);
+        for(int i = 0; i < leaf->count; i++)
+            leaf->datapoints[i] = entries[next++];
+        updateMBRandHV(leaf);
+        if(j > 0){
+            leaf->prev = level[j-1];
+            level[j-1]->next = leaf;
+        }
+        level[j] = leaf;
+    }
+    while(nodeCount > 1){
+        long long int parentCount = (nodeCount + ORDER - 1)/ORDER;
+        next = 0;
+        for(long long int j = 0; j < parentCount; j++){
+            HRTNode * p = createNewNode(NONLEAFNODE);
+            p->count = nodeCount/parentCount + (j < nodeCount%parentCount);
+            for(int i = 0; i < p->count; i++){
+                p->children[i] = level[next++];
+                p->children[i]->parent = p;
+            }
+            updateMBRandHV(p);
+            level[j] = p;
+        }
+        nodeCount = parentCount;
+    }
+    hrt->root = level[0];
+    free(level);
+    return hrt;
+}
+
+/*
+    * Function: createReorgCursor
+    * -------------------------------
+    * Creates a cursor positioned at the start of a reorganization pass
+    * Time complexity: O(1)
+*/
+reorgCursor createReorgCursor(){
+    reorgCursor cursor;
+    cursor.nextHilbertValue = 0;
+    cursor.done = false;
+    return cursor;
+}
+
+/*
+    * Function: removeChildHRT
+    * -------------------------------
+    * Removes a child from its parent, keeping the remaining children in order
+    * p: parent node
+    * child: child to be removed
+    * Time complexity: O(M)
+    * M is maximum number of entries in a node
+*/
+void removeChildHRT(HRTNode * p, HRTNode * child){
+    int i = 0;
+    while(i < p->count && p->children[i] != child)
+        i++;
+    for(; i < p->count - 1; i++)
+        p->children[i] = p->children[i+1];
+    p->count--;
+}
+
+/*
+    * Function: repackNonleafRunHRT
+    * -------------------------------
+    * Repacks the children of a run of up to SPLITTING sibling nonleaf nodes
+    * into as few of those nodes as can hold them, keeping the children in
+    * order and freeing the nodes left empty
+    * The run starts at the sibling before p, so room freed there by earlier
+    * runs of the pass is filled first
+    * p: nonleaf node whose run is to be repacked, may be freed
+    * Time complexity: O(s*M)
+    * M is maximum number of entries in a node
+    * s is number of cooperating siblings allowed
+*/
+void repackNonleafRunHRT(HRTNode * p){
+    HRTNode * gp = p->parent;
+    if(gp == NULL)
+        return;
+    int pos = 0;
+    while(gp->children[pos] != p)
+        pos++;
+    pos = max(0, pos - 1);
+    int runLength = min(SPLITTING, gp->count - pos), total = 0;
+    HRTNode * run[SPLITTING];
+    for(int j = 0; j < runLength; j++){
+        run[j] = gp->children[pos + j];
+        total += run[j]->count;
+    }
+    int needed = max(1, (total + ORDER - 1)/ORDER);
+    if(needed >= runLength)
+        return;
+
+    HRTNode * entries[ORDER*SPLITTING];
+    int entryCount = 0;
+    for(int j = 0; j < runLength; j++)
+        for(int i = 0; i < run[j]->count; i++)
+            entries[entryCount++] = run[j]->children[i];
+    int next = 0;
+    for(int j = 0; j < needed; j++){
+        run[j]->count = total/needed + (j < total%needed);
+        for(int i = 0; i < run[j]->count; i++){
+            run[j]->children[i] = entries[next++];
+            run[j]->children[i]->parent = run[j];
+        }
+        updateMBRandHV(run[j]);
+    }
+    for(int j = needed; j < runLength; j++){
+        removeChildHRT(gp, run[j]);
+        free(run[j]);
+    }
+}
+
+/*
+    * Function: reorganizeHRTStep
+    * -------------------------------
+    * Runs one bounded step of an online reorganization pass
+    * Walks the leaf chain in hilbert order from the cursor, repacking each run
+    * of up to SPLITTING sibling leaves into as few leaves as can hold their
+    * entries, then repacks the runs of nonleaf siblings starting at each
+    * ancestor of the run the same way and re-tightens the bounding rectangles
+    * A root left with one child is removed
+    * hrt: hilbertRTree to be reorganized
+    * cursor: position of the pass, updated to where the step stopped
+    * Nodes emptied by a repack are freed, invalidating any open hrtCursor
+    * maxLeaves: number of leaves to visit in this step, at least one; the last
+    *            run is always taken whole, so up to SPLITTING-1 more may be visited
+    * Returns true once the pass has reached the last leaf
+    * Time complexity: O((maxLeaves+s)*s*M*h)
+    * M is maximum number of entries in a node
+    * s is number of cooperating siblings allowed
+    * h is height of the tree
+*/
+bool reorganizeHRTStep(hilbertRTree * hrt, reorgCursor * cursor, int maxLeaves){
+    if(cursor->done)
+        return true;
+    maxLeaves = max(1, maxLeaves);
+    HRTNode * leaf = findLeafHRT(hrt, cursor->nextHilbertValue);
+    int visited = 0;
+    while(leaf != NULL && visited < maxLeaves){
+        HRTNode * run[SPLITTING];
+        int runLength = 1, total = leaf->count;
+        run[0] = leaf;
+        while(runLength < SPLITTING && run[runLength-1]->next != NULL && run[runLength-1]->next->parent == leaf->parent){
+            run[runLength] = run[runLength-1]->next;
+            total += run[runLength]->count;
+            runLength++;
+        }
+        visited += runLength;
+
+        int needed = max(1, (total + ORDER - 1)/ORDER);
+        if(needed < runLength){
+            spatialData * entries[ORDER*SPLITTING];
+            int entryCount = 0;
+            for(int j = 0; j < runLength; j++)
+                for(int i = 0; i < run[j]->count; i++)
+                    entries[entryCount++] = run[j]->datapoints[i];
+            int next = 0;
+            for(int j = 0; j < needed; j++){
+                run[j]->count = total/needed + (j < total%needed);
+                for(int i = 0; i < run[j]->count; i++)
+                    run[j]->datapoints[i] = entries[next++];
+            }
+            HRTNode * last = run[needed-1];
+            last->next = run[runLength-1]->next;
+            if(last->next != NULL)
+                last->next->prev = last;
+            for(int j = needed; j < runLength; j++){
+                removeChildHRT(leaf->parent, run[j]);
+                free(run[j]);
+            }
+            runLength = needed;
+        }
+        for(int j = 0; j < runLength; j++)
+            updateMBRandHV(run[j]);
+        for(HRTNode * p = leaf->parent, * gp; p != NULL; p = gp){
+            gp = p->parent;
+            updateMBRandHV(p);
+            repackNonleafRunHRT(p);
+        }
+
+        cursor->nextHilbertValue = run[runLength-1]->maxHilbertValue + 1;
+        leaf = run[runLength-1]->next;
+    }
+    while(hrt->root->type == NONLEAFNODE && hrt->root->count == 1){
+        HRTNode * oldRoot = hrt->root;
+        hrt->root = oldRoot->children[0];
+        hrt->root->parent = NULL;
+        free(oldRoot);
     }
-    adjustTree(hrt, affectedNodes);
-    freeLinkedList(affectedNodes);
+    if(leaf == NULL)
+        cursor->done = true;
+    return cursor->done;
 }
 
 /*
@@ -12,10 +12,72 @@
 */
 LinkedList * searchHRT(hilbertRTree * hrt, rect queryRect);
 
+/*
+    * Function: createSearchOptions
+    * -------------------------------
+    * Creates search options with no limit, budget, deadline or cancel flag
+    * Time complexity: O(1)
+*/
+searchOptions createSearchOptions();
+
+/*
+    * Function: createSearchContinuation
+    * -------------------------------
+    * Creates a continuation positioned at the start of a search
+    * Time complexity: O(1)
+*/
+searchContinuation createSearchContinuation();
+
+/*
+    * Function: searchBoundedHRT
+    * -------------------------------
+    * Searches for datapoints in a rectangle, stopping early once options.limit
+    * datapoints are found, options.visitBudget nodes are visited,
+    * options.timeLimitMs milliseconds pass or *options.cancel is set
+    * Datapoints are found in hilbert order and appended to result; calling
+    * again with the same continuation returns the ones not yet found
+    * The budget and deadline are only enforced once at least one datapoint
+    * has been examined, so repeated calls always make progress
+    * The continuation relies on a depth-first walk meeting datapoints in
+    * non-decreasing hilbert order, which insertion keeps even for repeated keys
+    * hrt: hilbert r tree which is to be searched
+    * queryRect: rectangle in which datapoints are to be searched
+    * options: limits of the search, zero or NULL fields are unbounded
+    * cont: continuation created by createSearchContinuation
+    * result: linked list in which results are to be stored
+    * Returns SEARCHCOMPLETE, SEARCHTRUNCATED, SEARCHTIMEDOUT or SEARCHCANCELLED
+    * Time complexity: O(n*M)
+    * n is number of nodes visited
+    * M is maximum number of entries in a node
+*/
+int searchBoundedHRT(hilbertRTree * hrt, rect queryRect, searchOptions options, searchContinuation * cont, LinkedList * result);
+
+/*
+    * Function: searchLODHRT
+    * -------------------------------
+    * Searches a rectangle at a level of detail bounded by maxResults
+    * Stops descending once expanding a node would exceed maxResults and
+    * returns lodClusters holding a node's bounding rectangle, datapoint count
+    * and a representative datapoint, or single datapoints where the budget
+    * allows; the caller frees the clusters and the list
+    * The representative of a cluster always intersects the query rectangle,
+    * and nodes holding no datapoint in it are dropped
+    * The count of a cluster covers its whole subtree, including datapoints
+    * just outside the query rectangle
+    * hrt: hilbert r tree which is to be searched
+    * queryRect: rectangle in which datapoints are to be searched
+    * maxResults: maximum number of clusters to be returned
+    * Time complexity: O(maxResults*M*h)
+    * M is maximum number of entries in a node
+    * h is height of the tree
+*/
+LinkedList * searchLODHRT(hilbertRTree * hrt, rect queryRect, int maxResults);
+
 /*
     * Function: insertToHRT
     * -------------------------------
     * Inserts a datapoint into the hilbertRTree
+    * Allocates memory only when a node has to be split
     * hrt: hilbertRTree to be inserted into
     * sd: spatial data point to be inserted
     * Time complexity: O(s*M + h)
@@ -25,6 +87,72 @@ LinkedList * searchHRT(hilbertRTree * hrt, rect queryRect);
 */
 void insertToHRT(hilbertRTree * hrt, spatialData *sd);
 
+/*
+    * Function: scanHilbertRangeHRT
+    * -------------------------------
+    * Creates a cursor over all datapoints with hilbert value in [hlo, hhi]
+    * The cursor walks the leaf chain and is invalidated by any insertion or
+    * reorganizeHRTStep, which may free the leaf it points at; re-seek with
+    * scanHilbertRangeHRT from the last hilbert value returned to resume
+    * hrt: hilbert r tree which is to be scanned
+    * hlo: lowest hilbert value to be returned
+    * hhi: highest hilbert value to be returned
+    * Time complexity: O(M*h)
+    * M is maximum number of entries in a node
+    * h is height of the tree
+*/
+hrtCursor scanHilbertRangeHRT(hilbertRTree * hrt, long long int hlo, long long int hhi);
+
+/*
+    * Function: nextHRTCursor
+    * -------------------------------
+    * Returns the next datapoint of a cursor in hilbert order, or NULL once
+    * the range is exhausted
+    * cursor: cursor created by scanHilbertRangeHRT
+    * Time complexity: O(1) amortized
+*/
+spatialData * nextHRTCursor(hrtCursor * cursor);
+
+/*
+    * Function: exportHRT
+    * -------------------------------
+    * Streams every datapoint of the tree to a callback in hilbert order
+    * hrt: hilbert r tree to be exported
+    * emit: callback invoked once per datapoint
+    * ctx: passed through to emit unchanged
+    * Time complexity: O(n + M*h)
+    * n is number of datapoints in the tree
+*/
+void exportHRT(hilbertRTree * hrt, void (*emit)(spatialData *, void *), void * ctx);
+
+/*
+    * Function: createReorgCursor
+    * -------------------------------
+    * Creates a cursor positioned at the start of a reorganization pass
+    * Time complexity: O(1)
+*/
+reorgCursor createReorgCursor();
+
+/*
+    * Function: reorganizeHRTStep
+    * -------------------------------
+    * Runs one bounded step of an online reorganization pass
+    * Merges underfull runs of sibling leaves in hilbert order, and the runs of
+    * nonleaf siblings above them, and re-tightens their bounding rectangles,
+    * so it can be interleaved with inserts and queries in small time slices
+    * hrt: hilbertRTree to be reorganized
+    * cursor: position of the pass, updated to where the step stopped
+    * Nodes emptied by a repack are freed, invalidating any open hrtCursor
+    * maxLeaves: number of leaves to visit in this step, at least one; the last
+    *            run is always taken whole, so up to SPLITTING-1 more may be visited
+    * Returns true once the pass has reached the last leaf
+    * Time complexity: O((maxLeaves+s)*s*M*h)
+    * M is maximum number of entries in a node
+    * s is number of cooperating siblings allowed
+    * h is height of the tree
+*/
+bool reorganizeHRTStep(hilbertRTree * hrt, reorgCursor * cursor, int maxLeaves);
+
 /*
     * Function: createHilbertRTree
     * -------------------------------
@@ -33,6 +161,29 @@ void insertToHRT(hilbertRTree * hrt, spatialData *sd);
 */
 hilbertRTree* createHilbertRTree();
 
+/*
+    * Function: buildHilbertRTree
+    * -------------------------------
+    * Builds a packed hilbert r tree from datapoints sorted by hilbert value
+    * in one pass, filling each level with as few nodes as can hold it
+    * entries: datapoints in non-decreasing hilbert order
+    * count: number of datapoints
+    * Time complexity: O(n)
+    * n is number of datapoints
+*/
+hilbertRTree * buildHilbertRTree(spatialData ** entries, long long int count);
+
+/*
+    * Function: freeHilbertRTree
+    * -------------------------------
+    *  Frees a hilbert r tree and all its nodes
+    *  Datapoints are owned by the caller and are not freed
+    *  hrt: hilbert r tree to be freed
+    *  Time complexity: O(n)
+    *  n is number of nodes in the tree
+*/
+void freeHilbertRTree(hilbertRTree * hrt);
+
 /*
     * Function: preorderHilbert
     * -------------------------------
@@ -1,6 +1,9 @@
 #ifndef HILBERT_R_TREE_DS_H
 #define HILBERT_R_TREE_DS_H
 
+#include <stdatomic.h>
+#include <time.h>
+
 #define ORDER 4
 #define DIMENSIONS 2
 #define LEAFNODE 0
@@ -10,6 +13,13 @@
 #define BUFFERSIZE 1024
 #define GRIDSIZE 1048576
 #define SPLITTING 4
+#define MAXHILBERTVALUE ((long long int) GRIDSIZE * GRIDSIZE - 1)
+#define DEADLINECHECK 64
+
+#define SEARCHCOMPLETE 0
+#define SEARCHTRUNCATED 1
+#define SEARCHTIMEDOUT 2
+#define SEARCHCANCELLED 3
 
 #define max(a, b) ((a>b?a:b))
 #define min(a, b) ((a<b?a:b))
@@ -30,7 +40,10 @@ typedef struct HRTNode{
     int count;
     rect maxBoundingRect;
     struct HRTNode* parent;
+    struct HRTNode* prev;
+    struct HRTNode* next;
     long long int maxHilbertValue;
+    long long int subtreeCount;
     union
     {
         spatialData * datapoints[ORDER];
@@ -42,4 +55,56 @@ typedef struct hilbertRTree{
     HRTNode * root;
 } hilbertRTree;
 
+typedef struct lodCluster{
+    rect r;
+    long long int count;
+    spatialData * representative;
+    HRTNode * node;
+} lodCluster;
+
+typedef struct searchOptions{
+    int limit;
+    long long int visitBudget;
+    double timeLimitMs;
+    atomic_int * cancel;
+} searchOptions;
+
+typedef struct searchContinuation{
+    long long int hilbertValue;
+    int skip;
+    bool done;
+} searchContinuation;
+
+typedef struct boundedSearch{
+    rect queryRect;
+    searchOptions options;
+    searchContinuation * cont;
+    long long int startHilbertValue;
+    int startSkip;
+    int skipped;
+    int found;
+    long long int examined;
+    long long int visits;
+    struct timespec start;
+    int status;
+    LinkedList * result;
+} boundedSearch;
+
+typedef struct overflowResult{
+    HRTNode * nodes[SPLITTING + 1];
+    int count;
+    HRTNode * splitNode;
+} overflowResult;
+
+typedef struct hrtCursor{
+    HRTNode * leaf;
+    int index;
+    long long int highHilbertValue;
+} hrtCursor;
+
+typedef struct reorgCursor{
+    long long int nextHilbertValue;
+    bool done;
+} reorgCursor;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,414 @@
+#include "hilbert_r_tree_sharded.h"
+
+/*
+    * Function: createShard
+    * -------------------------------
+    *  Creates an empty shard owning hilbert values in [low, high)
+    *  Time complexity: O(1)
+*/
+hrtShard * createShard(long long int low, long long int high){
+    hrtShard * shard = (hrtShard *) malloc(sizeof(hrtShard));
+    shard->lowHilbertValue = low;
+    shard->highHilbertValue = high;
+    shard->tree = createHilbertRTree();
+    shard->size = 0;
+    shard->rebalanceSize = MINSHARDSPLIT;
+    shard->splitRetrySize = 0;
+    shard->retired = false;
+    pthread_mutex_init(&shard->lock, NULL);
+    return shard;
+}
+
+/*
+    * Function: freeShard
+    * -------------------------------
+    *  Frees a shard and its tree, datapoints are not freed
+    *  Time complexity: O(n)
+    *  n is number of nodes in the shard's tree
+*/
+void freeShard(hrtShard * shard){
+    pthread_mutex_destroy(&shard->lock);
+    if(shard->tree != NULL)
+        freeHilbertRTree(shard->tree);
+    free(shard);
+}
+
+/*
+    * Function: createShardedHRT
+    * -------------------------------
+    *  Creates a sharded hilbert r tree whose hilbert key space is split
+    *  evenly between shardCount trees, each guarded by its own lock
+    *  shardCount: number of shards to start with (1 to MAXSHARDS)
+    *  Time complexity: O(shardCount)
+*/
+shardedHRT * createShardedHRT(int shardCount){
+    shardCount = max(1, min(shardCount, MAXSHARDS));
+    shardedHRT * shrt = (shardedHRT *) malloc(sizeof(shardedHRT));
+    shardMap * map = (shardMap *) malloc(sizeof(shardMap));
+    map->shardCount = shardCount;
+    long long int width = HILBERTSPACE / shardCount;
+    for(int i = 0; i < shardCount; i++){
+        long long int high = i == shardCount - 1 ? HILBERTSPACE : (i + 1) * width;
+        map->shards[i] = createShard(i * width, high);
+    }
+    atomic_init(&shrt->map, map);
+    pthread_mutex_init(&shrt->rebalanceLock, NULL);
+    shrt->retiredShards = createLinkedList();
+    shrt->retiredMaps = createLinkedList();
+    return shrt;
+}
+
+/*
+    * Function: findShard
+    * -------------------------------
+    *  Finds the index of the shard owning a hilbert value in a shard map
+    *  Time complexity: O(log(S))
+    *  S is number of shards
+*/
+int findShard(shardMap * map, long long int h){
+    int lo = 0, hi = map->shardCount - 1;
+    while(lo < hi){
+        int mid = (lo + hi + 1) / 2;
+        if(map->shards[mid]->lowHilbertValue <= h)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+/*
+    * Function: searchShardedHRT
+    * -------------------------------
+    * Searches for all datapoints in a rectangle, visiting only shards
+    * whose root bounding rectangle intersects the query
+    * Restarts if a shard is replaced by a rebalance while it runs
+    * shrt: sharded hilbert r tree which is to be searched
+    * queryRect: rectangle in which datapoints are to be searched
+*/
+LinkedList * searchShardedHRT(shardedHRT * shrt, rect queryRect){
+    while(true){
+        LinkedList * result = createLinkedList();
+        shardMap * map = atomic_load(&shrt->map);
+        bool retired = false;
+        for(int i = 0; i < map->shardCount && !retired; i++){
+            hrtShard * shard = map->shards[i];
+            pthread_mutex_lock(&shard->lock);
+            retired = shard->retired;
+            if(!retired && shard->size > 0 && rectangleIntersects(shard->tree->root->maxBoundingRect, queryRect))
+                recursiveHRTSearch(shard->tree->root, queryRect, result);
+            pthread_mutex_unlock(&shard->lock);
+        }
+        if(!retired)
+            return result;
+        freeLinkedList(result);
+    }
+}
+
+/*
+    * Function: leftmostLeaf
+    * -------------------------------
+    *  Returns the first leaf of a tree in hilbert order
+    *  Time complexity: O(h)
+    *  h is height of the tree
+*/
+HRTNode * leftmostLeaf(hilbertRTree * hrt){
+    HRTNode * n = hrt->root;
+    while(n->type != LEAFNODE)
+        n = n->children[0];
+    return n;
+}
+
+/*
+    * Function: collectShard
+    * -------------------------------
+    *  Appends all datapoints of a shard to an array in hilbert order by
+    *  walking its leaf chain
+    *  Time complexity: O(n)
+    *  n is number of datapoints in the shard
+*/
+void collectShard(hrtShard * shard, spatialData ** out, long long int * count){
+    for(HRTNode * leaf = leftmostLeaf(shard->tree); leaf != NULL; leaf = leaf->next)
+        for(int i = 0; i < leaf->count; i++)
+            out[(*count)++] = leaf->datapoints[i];
+}
+
+/*
+    * Function: hasSplitPoint
+    * -------------------------------
+    *  Checks whether a shard holds more than one distinct hilbert value
+    *  Caller must hold the shard's lock
+    *  Time complexity: O(h)
+*/
+bool hasSplitPoint(hrtShard * shard){
+    if(shard->size < 2)
+        return false;
+    return leftmostLeaf(shard->tree)->datapoints[0]->hilbertValue < shard->tree->root->maxHilbertValue;
+}
+
+/*
+    * Function: refillShard
+    * -------------------------------
+    *  Replaces the tree of a shard with one packed from entries[from, to),
+    *  which must be in hilbert order
+    *  Time complexity: O(n)
+    *  n is number of entries
+*/
+void refillShard(hrtShard * shard, spatialData ** entries, long long int from, long long int to){
+    freeHilbertRTree(shard->tree);
+    shard->tree = buildHilbertRTree(entries + from, to - from);
+    shard->size = to - from;
+    shard->splitRetrySize = 0;
+}
+
+/*
+    * Function: retireShard
+    * -------------------------------
+    *  Marks a shard replaced by a rebalance and frees its tree
+    *  The shard itself is kept until freeShardedHRT, as threads that read
+    *  it from an older shard map may still be waiting on its lock
+    *  Caller must hold rebalanceLock and the shard's lock
+    *  Time complexity: O(n)
+    *  n is number of nodes in the shard's tree
+*/
+void retireShard(shardedHRT * shrt, hrtShard * shard){
+    shard->retired = true;
+    freeHilbertRTree(shard->tree);
+    shard->tree = NULL;
+    llInsert(shrt->retiredShards, shard);
+}
+
+/*
+    * Function: publishShardMap
+    * -------------------------------
+    *  Makes a new shard map current, keeping the old one until
+    *  freeShardedHRT for threads still reading it
+    *  Caller must hold rebalanceLock
+    *  Time complexity: O(1)
+*/
+void publishShardMap(shardedHRT * shrt, shardMap * map){
+    llInsert(shrt->retiredMaps, atomic_load(&shrt->map));
+    atomic_store(&shrt->map, map);
+}
+
+/*
+    * Function: mergeShards
+    * -------------------------------
+    *  Replaces shards i and i+1 with one shard holding both
+    *  Only the two shards are locked while the new tree is built
+    *  Caller must hold rebalanceLock
+*/
+void mergeShards(shardedHRT * shrt, int i){
+    shardMap * map = atomic_load(&shrt->map);
+    hrtShard * left = map->shards[i], * right = map->shards[i+1];
+    pthread_mutex_lock(&left->lock);
+    pthread_mutex_lock(&right->lock);
+    spatialData ** entries = (spatialData **) malloc(sizeof(spatialData *) * max(1, left->size + right->size));
+    long long int count = 0;
+    collectShard(left, entries, &count);
+    collectShard(right, entries, &count);
+    hrtShard * merged = createShard(left->lowHilbertValue, right->highHilbertValue);
+    refillShard(merged, entries, 0, count);
+    free(entries);
+
+    shardMap * next = (shardMap *) malloc(sizeof(shardMap));
+    *next = *map;
+    next->shards[i] = merged;
+    for(int j = i + 1; j < next->shardCount - 1; j++)
+        next->shards[j] = next->shards[j+1];
+    next->shardCount--;
+    publishShardMap(shrt, next);
+    retireShard(shrt, left);
+    retireShard(shrt, right);
+    pthread_mutex_unlock(&right->lock);
+    pthread_mutex_unlock(&left->lock);
+}
+
+/*
+    * Function: splitShard
+    * -------------------------------
+    *  Replaces shard i with two shards split at the hilbert value of its
+    *  median datapoint
+    *  The shard must hold more than one distinct hilbert value
+    *  Only the shard is locked while the new trees are built
+    *  Caller must hold rebalanceLock
+*/
+void splitShard(shardedHRT * shrt, int i){
+    shardMap * map = atomic_load(&shrt->map);
+    hrtShard * shard = map->shards[i];
+    pthread_mutex_lock(&shard->lock);
+    spatialData ** entries = (spatialData **) malloc(sizeof(spatialData *) * shard->size);
+    long long int count = 0;
+    collectShard(shard, entries, &count);
+
+    long long int mid = count / 2;
+    long long int splitValue = entries[mid]->hilbertValue;
+    while(mid > 0 && entries[mid-1]->hilbertValue == splitValue)
+        mid--;
+    if(mid == 0){
+        while(entries[mid]->hilbertValue == splitValue)
+            mid++;
+        splitValue = entries[mid]->hilbertValue;
+    }
+
+    hrtShard * lower = createShard(shard->lowHilbertValue, splitValue);
+    hrtShard * upper = createShard(splitValue, shard->highHilbertValue);
+    refillShard(lower, entries, 0, mid);
+    refillShard(upper, entries, mid, count);
+    free(entries);
+
+    shardMap * next = (shardMap *) malloc(sizeof(shardMap));
+    *next = *map;
+    for(int j = next->shardCount; j > i + 1; j--)
+        next->shards[j] = next->shards[j-1];
+    next->shards[i] = lower;
+    next->shards[i+1] = upper;
+    next->shardCount++;
+    publishShardMap(shrt, next);
+    retireShard(shrt, shard);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/*
+    * Function: shardSizes
+    * -------------------------------
+    *  Reads the size of every shard of a shard map and returns their total
+    *  Time complexity: O(S)
+    *  S is number of shards
+*/
+long long int shardSizes(shardMap * map, long long int * sizes){
+    long long int total = 0;
+    for(int i = 0; i < map->shardCount; i++){
+        pthread_mutex_lock(&map->shards[i]->lock);
+        sizes[i] = map->shards[i]->size;
+        pthread_mutex_unlock(&map->shards[i]->lock);
+        total += sizes[i];
+    }
+    return total;
+}
+
+/*
+    * Function: rebalanceShards
+    * -------------------------------
+    *  Body of rebalanceShardedHRT
+    *  Caller must hold rebalanceLock
+*/
+void rebalanceShards(shardedHRT * shrt){
+    long long int sizes[MAXSHARDS];
+    while(true){
+        shardMap * map = atomic_load(&shrt->map);
+        long long int total = shardSizes(map, sizes);
+        int largest = -1;
+        for(int i = 0; i < map->shardCount; i++)
+            if(sizes[i] >= map->shards[i]->splitRetrySize && (largest == -1 || sizes[i] > sizes[largest]))
+                largest = i;
+        if(largest == -1 || sizes[largest] < MINSHARDSPLIT || sizes[largest] * map->shardCount <= SHARDSKEW * total)
+            break;
+        hrtShard * shard = map->shards[largest];
+        pthread_mutex_lock(&shard->lock);
+        bool splittable = hasSplitPoint(shard);
+        pthread_mutex_unlock(&shard->lock);
+        if(!splittable){
+            shard->splitRetrySize = sizes[largest] * SHARDRETRYFACTOR;
+            continue;
+        }
+
+        if(map->shardCount == MAXSHARDS){
+            int smallest = -1;
+            for(int i = 0; i + 1 < map->shardCount; i++){
+                if(i == largest || i + 1 == largest)
+                    continue;
+                if(smallest == -1 || sizes[i] + sizes[i+1] < sizes[smallest] + sizes[smallest+1])
+                    smallest = i;
+            }
+            if(smallest == -1 || sizes[smallest] + sizes[smallest+1] >= sizes[largest])
+                shard->splitRetrySize = sizes[largest] * SHARDRETRYFACTOR;
+            else
+                mergeShards(shrt, smallest);
+            continue;
+        }
+        splitShard(shrt, largest);
+    }
+
+    shardMap * map = atomic_load(&shrt->map);
+    long long int average = shardSizes(map, sizes) / map->shardCount;
+    for(int i = 0; i < map->shardCount; i++){
+        hrtShard * shard = map->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        shard->rebalanceSize = max(max(MINSHARDSPLIT, SHARDSKEW * average + 1), max(shard->splitRetrySize, shard->size + shard->size / SHARDSKEW));
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+/*
+    * Function: rebalanceShardedHRT
+    * -------------------------------
+    * Splits shards holding more than SHARDSKEW times the average number of
+    * datapoints at their median hilbert value, merging the smallest pair of
+    * neighbouring shards first when MAXSHARDS is reached, then refreshes the
+    * rebalanceSize of every shard from the new average
+    * A shard that cannot be split is left alone until it grows by
+    * SHARDRETRYFACTOR
+    * Only inserts and searches reaching a shard being split or merged wait
+    * for it; the others carry on against the previous shard map
+    * shrt: sharded hilbert r tree to be rebalanced
+    * Time complexity: O(n) for the n datapoints moved
+*/
+void rebalanceShardedHRT(shardedHRT * shrt){
+    pthread_mutex_lock(&shrt->rebalanceLock);
+    rebalanceShards(shrt);
+    pthread_mutex_unlock(&shrt->rebalanceLock);
+}
+
+/*
+    * Function: insertToShardedHRT
+    * -------------------------------
+    * Inserts a datapoint into the shard owning its hilbert value
+    * Safe to call from several threads at once; only the shard's lock is
+    * taken, unless the shard has grown past its rebalanceSize
+    * shrt: sharded hilbert r tree to be inserted into
+    * sd: spatial data point to be inserted, hilbertValue must be set
+    * Time complexity: O(log(S) + s*M + h)
+    * S is number of shards
+*/
+void insertToShardedHRT(shardedHRT * shrt, spatialData * sd){
+    hrtShard * shard;
+    while(true){
+        shardMap * map = atomic_load(&shrt->map);
+        shard = map->shards[findShard(map, sd->hilbertValue)];
+        pthread_mutex_lock(&shard->lock);
+        if(!shard->retired)
+            break;
+        pthread_mutex_unlock(&shard->lock);
+    }
+    insertToHRT(shard->tree, sd);
+    bool skewed = ++shard->size >= shard->rebalanceSize;
+    pthread_mutex_unlock(&shard->lock);
+
+    if(skewed && pthread_mutex_trylock(&shrt->rebalanceLock) == 0){
+        rebalanceShards(shrt);
+        pthread_mutex_unlock(&shrt->rebalanceLock);
+    }
+}
+
+/*
+    * Function: freeShardedHRT
+    * -------------------------------
+    *  Frees a sharded hilbert r tree, its shards and their trees
+    *  Datapoints are owned by the caller and are not freed
+    *  shrt: sharded hilbert r tree to be freed
+*/
+void freeShardedHRT(shardedHRT * shrt){
+    shardMap * map = atomic_load(&shrt->map);
+    for(int i = 0; i < map->shardCount; i++)
+        freeShard(map->shards[i]);
+    free(map);
+    for(LLNode * curr = shrt->retiredShards->head; curr != NULL; curr = curr->next)
+        freeShard(curr->data);
+    for(LLNode * curr = shrt->retiredMaps->head; curr != NULL; curr = curr->next)
+        free(curr->data);
+    freeLinkedList(shrt->retiredShards);
+    freeLinkedList(shrt->retiredMaps);
+    pthread_mutex_destroy(&shrt->rebalanceLock);
+    free(shrt);
+}
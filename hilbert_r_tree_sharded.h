@@ -0,0 +1,96 @@
+#ifndef HILBERT_R_TREE_SHARDED_H
+#define HILBERT_R_TREE_SHARDED_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "hilbert_r_tree_ds.h"
+
+#define MAXSHARDS 64
+#define HILBERTSPACE (MAXHILBERTVALUE + 1)
+#define SHARDSKEW 2
+#define MINSHARDSPLIT (ORDER * ORDER * ORDER)
+#define SHARDRETRYFACTOR 2
+
+typedef struct hrtShard{
+    long long int lowHilbertValue;
+    long long int highHilbertValue;
+    hilbertRTree * tree;
+    long long int size;
+    long long int rebalanceSize;
+    long long int splitRetrySize;
+    bool retired;
+    pthread_mutex_t lock;
+} hrtShard;
+
+typedef struct shardMap{
+    int shardCount;
+    hrtShard * shards[MAXSHARDS];
+} shardMap;
+
+typedef struct shardedHRT{
+    _Atomic(shardMap *) map;
+    pthread_mutex_t rebalanceLock;
+    LinkedList * retiredShards;
+    LinkedList * retiredMaps;
+} shardedHRT;
+
+/*
+    * Function: createShardedHRT
+    * -------------------------------
+    *  Creates a sharded hilbert r tree whose hilbert key space is split
+    *  evenly between shardCount trees, each guarded by its own lock
+    *  shardCount: number of shards to start with (1 to MAXSHARDS)
+    *  Time complexity: O(shardCount)
+*/
+shardedHRT * createShardedHRT(int shardCount);
+
+/*
+    * Function: insertToShardedHRT
+    * -------------------------------
+    * Inserts a datapoint into the shard owning its hilbert value
+    * Safe to call from several threads at once; only the shard's lock is
+    * taken, unless the shard has grown past its rebalanceSize
+    * shrt: sharded hilbert r tree to be inserted into
+    * sd: spatial data point to be inserted, hilbertValue must be set
+    * Time complexity: O(log(S) + s*M + h)
+    * S is number of shards
+*/
+void insertToShardedHRT(shardedHRT * shrt, spatialData * sd);
+
+/*
+    * Function: searchShardedHRT
+    * -------------------------------
+    * Searches for all datapoints in a rectangle, visiting only shards
+    * whose root bounding rectangle intersects the query
+    * Restarts if a shard is replaced by a rebalance while it runs
+    * shrt: sharded hilbert r tree which is to be searched
+    * queryRect: rectangle in which datapoints are to be searched
+*/
+LinkedList * searchShardedHRT(shardedHRT * shrt, rect queryRect);
+
+/*
+    * Function: rebalanceShardedHRT
+    * -------------------------------
+    * Splits shards holding more than SHARDSKEW times the average number of
+    * datapoints at their median hilbert value, merging the smallest pair of
+    * neighbouring shards first when MAXSHARDS is reached, then refreshes the
+    * rebalanceSize of every shard from the new average
+    * A shard that cannot be split is left alone until it grows by
+    * SHARDRETRYFACTOR
+    * Only inserts and searches reaching a shard being split or merged wait
+    * for it; the others carry on against the previous shard map
+    * shrt: sharded hilbert r tree to be rebalanced
+    * Time complexity: O(n) for the n datapoints moved
+*/
+void rebalanceShardedHRT(shardedHRT * shrt);
+
+/*
+    * Function: freeShardedHRT
+    * -------------------------------
+    *  Frees a sharded hilbert r tree, its shards and their trees
+    *  Datapoints are owned by the caller and are not freed
+    *  shrt: sharded hilbert r tree to be freed
+*/
+void freeShardedHRT(shardedHRT * shrt);
+
+#endif